@@ -25,10 +25,12 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 SOURCES += main.cpp\
         mainwindow.cpp \
-    base/convert.cpp
+    base/convert.cpp \
+    base/filter.cpp
 
 HEADERS  += mainwindow.h \
-    base/convert.h
+    base/convert.h \
+    base/filter.h
 
 FORMS    += mainwindow.ui
 
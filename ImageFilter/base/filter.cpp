@@ -0,0 +1,824 @@
+#include "base/filter.h"
+#include "base/convert.h"
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace jz
+{
+
+namespace filter
+{
+    // anonymous namespace include help functions for internal use
+    namespace
+    {
+        // bytes per column strip in the vertical box passes, each pass keeps
+        // one row of running sums for the strip and a ring of 2 * radius + 2
+        // strip rows, so small radii stay in L1 and large ones in L2
+        const int kStripBytes = 64;
+
+        // rows handed to a thread at once in the horizontal passes
+        const int kTileRows = 16;
+
+        // below this sigma three boxes approximate the gaussian poorly
+        // (up to 14 levels off on sharp edges between 2 and 2.5),
+        // while its exact kernel is still only up to 17 taps wide
+        const double kMinBoxSigma = 2.5;
+
+        // every median band starts by building its column histograms over
+        // 2 * radius + 1 rows, so bands are only split down to this height
+        const int kMedianMinBandRows = 32;
+
+        // bytes of column histograms a median tile slides down its rows,
+        // sized to stay in a 1 MB L2 cache
+        const int kMedianCacheBytes = 1024 * 1024;
+
+        // every row of a median strip rebuilds its kernel histograms over
+        // 2 * radius + 1 columns, so strips are at least this many radii wide
+        const int kMedianMinStripRadii = 4;
+
+        // median tiles handed out per thread, so uneven tiles still balance
+        const int kMedianTilesPerThread = 4;
+
+        inline bool IsSupported(const cv::Mat& mat)
+        {
+            return !mat.empty() &&
+                   (CV_8UC1 == mat.type() ||
+                    CV_8UC3 == mat.type() ||
+                    CV_8UC4 == mat.type());
+        }
+
+        inline int ClampRadius(int radius)
+        {
+            return std::min(std::max(radius, 0), kMaxRadius);
+        }
+
+        inline int Clamp(int value, int min_index, int max_index)
+        {
+            return std::min(std::max(value, min_index), max_index);
+        }
+
+        // number of indices of the window [first, last] that land on k once
+        // replicated over [0, max_index], k must lie in the clamped window
+        inline int ReplicatedWeight(int k, int first, int last, int max_index)
+        {
+            const int from = (0 == k) ? first : std::max(first, k);
+            const int to = (max_index == k) ? last : std::min(last, k);
+            return to - from + 1;
+        }
+
+        // one box pass along a row of interleaved pixels, src and dst must not overlap.
+        // dst[x] is the mean of src around x + offset, src is replicated beyond its ends
+        void BoxRow(const uchar* src, int src_cols,
+                    uchar* dst, int dst_cols,
+                    int offset, int cn, int radius)
+        {
+            const float scale = 1.0f / (2 * radius + 1);
+            const int last = src_cols - 1;
+            const int first = offset - radius;
+
+            for (int c = 0; c < cn; ++c)
+            {
+                uint sum = 0;
+                for (int k = Clamp(first, 0, last); k <= Clamp(first + 2 * radius, 0, last); ++k)
+                {
+                    sum += ReplicatedWeight(k, first, first + 2 * radius, last) * src[k * cn + c];
+                }
+
+                for (int x = 0; x < dst_cols; ++x)
+                {
+                    dst[x * cn + c] = static_cast<uchar>(sum * scale + 0.5f);
+                    sum += src[Clamp(x + offset + radius + 1, 0, last) * cn + c];
+                    sum -= src[Clamp(x + offset - radius, 0, last) * cn + c];
+                }
+            }
+        }
+
+        // margin each box pass must produce beyond the image on both sides,
+        // so that the passes after it never see a replicated intermediate
+        std::vector<int> PassMargins(const std::vector<int>& radii)
+        {
+            std::vector<int> margins(radii.size(), 0);
+            for (int i = static_cast<int>(radii.size()) - 2; i >= 0; --i)
+            {
+                margins[i] = margins[i + 1] + radii[i + 1];
+            }
+            return margins;
+        }
+
+        // runs every box pass on a band of rows
+        class HorizontalBoxBody : public cv::ParallelLoopBody
+        {
+        public:
+            HorizontalBoxBody(cv::Mat& mat, const std::vector<int>& radii)
+                : mat_(mat), radii_(radii), margins_(PassMargins(radii)) {}
+
+            void operator()(const cv::Range& range) const override
+            {
+                const int cn = mat_.channels();
+                const int cols = mat_.cols;
+                const int buffer_bytes = (cols + 2 * margins_[0]) * cn;
+                std::vector<uchar> buffer(2 * buffer_bytes);
+                uchar* scratch[] = { &buffer[0], &buffer[buffer_bytes] };
+
+                for (int y = range.start; y < range.end; ++y)
+                {
+                    uchar* row = mat_.ptr<uchar>(y);
+                    std::copy(row, row + cols * cn, scratch[0]);
+
+                    // ping-pong between the scratch rows, the last pass writes back
+                    int current = 0;
+                    int src_margin = 0;
+                    for (size_t i = 0; i < radii_.size(); ++i)
+                    {
+                        uchar* dst = (i + 1 == radii_.size()) ?
+                                    row : scratch[1 - current];
+                        BoxRow(scratch[current], cols + 2 * src_margin,
+                               dst, cols + 2 * margins_[i],
+                               src_margin - margins_[i], cn, radii_[i]);
+                        current = 1 - current;
+                        src_margin = margins_[i];
+                    }
+                }
+            }
+
+        private:
+            cv::Mat& mat_;
+            const std::vector<int>& radii_;
+            std::vector<int> margins_;
+        };
+
+        // one box pass down a strip of width bytes. input rows [in_first, in_last]
+        // are pushed top to bottom, replicated beyond their ends, and each output
+        // row of [out_first, out_last] can be popped as soon as its window is
+        // complete, so only the last 2 * radius + 2 input rows are kept in a ring
+        class ColumnBoxPass
+        {
+        public:
+            ColumnBoxPass(int radius, int in_first, int in_last, int out_first, int out_last)
+                : radius_(radius),
+                  in_first_(in_first),
+                  in_last_(in_last),
+                  out_first_(out_first),
+                  out_last_(out_last),
+                  ring_rows_(std::min(2 * radius + 2, in_last - in_first + 1)),
+                  scale_(1.0f / (2 * radius + 1)),
+                  ring_(ring_rows_ * kStripBytes),
+                  sums_(),
+                  output_() {}
+
+            void Reset(int width)
+            {
+                width_ = width;
+                pushed_ = in_first_;
+                popped_ = out_first_;
+            }
+
+            void Push(const uchar* row)
+            {
+                std::copy(row, row + width_, Input(pushed_));
+                ++pushed_;
+            }
+
+            // true if the next output row can be computed from the rows pushed so far
+            bool Ready() const
+            {
+                return popped_ <= out_last_ &&
+                       pushed_ > Clamp(popped_ + radius_, in_first_, in_last_);
+            }
+
+            const uchar* Pop()
+            {
+                const int y = popped_++;
+                if (out_first_ == y)
+                {
+                    const int first = y - radius_ - in_first_;
+                    const int last = y + radius_ - in_first_;
+                    const int max_index = in_last_ - in_first_;
+                    std::fill(sums_, sums_ + width_, 0);
+                    for (int k = Clamp(first, 0, max_index); k <= Clamp(last, 0, max_index); ++k)
+                    {
+                        const uint weight = ReplicatedWeight(k, first, last, max_index);
+                        const uchar* row = Input(k + in_first_);
+                        for (int j = 0; j < width_; ++j)
+                        {
+                            sums_[j] += weight * row[j];
+                        }
+                    }
+                }
+                else
+                {
+                    const uchar* add_row = Input(Clamp(y + radius_, in_first_, in_last_));
+                    const uchar* sub_row = Input(Clamp(y - radius_ - 1, in_first_, in_last_));
+                    for (int j = 0; j < width_; ++j)
+                    {
+                        sums_[j] += add_row[j];
+                        sums_[j] -= sub_row[j];
+                    }
+                }
+
+                for (int j = 0; j < width_; ++j)
+                {
+                    output_[j] = static_cast<uchar>(sums_[j] * scale_ + 0.5f);
+                }
+                return output_;
+            }
+
+            int width() const { return width_; }
+            int popped() const { return popped_; }
+
+        private:
+            uchar* Input(int y)
+            {
+                return &ring_[((y - in_first_) % ring_rows_) * kStripBytes];
+            }
+
+            int radius_;
+            int in_first_;
+            int in_last_;
+            int out_first_;
+            int out_last_;
+            int ring_rows_;
+            float scale_;
+            std::vector<uchar> ring_;
+            uint sums_[kStripBytes];
+            uchar output_[kStripBytes];
+            int width_ = 0;
+            int pushed_ = 0;
+            int popped_ = 0;
+        };
+
+        // runs every box pass on a strip of kStripBytes columns. the passes are
+        // chained row by row, so the strip is filtered in place in a single sweep
+        class VerticalBoxBody : public cv::ParallelLoopBody
+        {
+        public:
+            VerticalBoxBody(cv::Mat& mat, const std::vector<int>& radii)
+                : mat_(mat), radii_(radii) {}
+
+            void operator()(const cv::Range& range) const override
+            {
+                const int row_bytes = mat_.cols * mat_.channels();
+                const int last_row = mat_.rows - 1;
+                const std::vector<int> margins = PassMargins(radii_);
+                std::vector<ColumnBoxPass> passes;
+                int in_margin = 0;
+                for (size_t i = 0; i < radii_.size(); ++i)
+                {
+                    passes.push_back(ColumnBoxPass(radii_[i],
+                                                   -in_margin, last_row + in_margin,
+                                                   -margins[i], last_row + margins[i]));
+                    in_margin = margins[i];
+                }
+
+                for (int s = range.start; s < range.end; ++s)
+                {
+                    const int x0 = s * kStripBytes;
+                    const int width = std::min(kStripBytes, row_bytes - x0);
+                    for (size_t i = 0; i < passes.size(); ++i)
+                    {
+                        passes[i].Reset(width);
+                    }
+
+                    // the first pass reads each image row before the last pass
+                    // writes it, earlier rows it still needs are in its ring
+                    for (int y = 0; y <= last_row; ++y)
+                    {
+                        passes[0].Push(mat_.ptr<uchar>(y) + x0);
+                        Drain(passes, 0, x0);
+                    }
+                }
+            }
+
+        private:
+            // hand every row pass i can produce to the next pass, or to the image
+            void Drain(std::vector<ColumnBoxPass>& passes, size_t i, int x0) const
+            {
+                while (passes[i].Ready())
+                {
+                    const uchar* row = passes[i].Pop();
+                    if (i + 1 == passes.size())
+                    {
+                        uchar* dst = mat_.ptr<uchar>(passes[i].popped() - 1) + x0;
+                        std::copy(row, row + passes[i].width(), dst);
+                    }
+                    else
+                    {
+                        passes[i + 1].Push(row);
+                        Drain(passes, i + 1, x0);
+                    }
+                }
+            }
+
+            cv::Mat& mat_;
+            const std::vector<int>& radii_;
+        };
+
+        // apply successive box blurs, separable so all horizontal passes
+        // are done on a row while it is in cache, then all vertical ones
+        void BoxPasses(cv::Mat& mat, std::vector<int> radii)
+        {
+            radii.erase(std::remove(radii.begin(), radii.end(), 0), radii.end());
+            if (radii.empty()) { return; }
+
+            const int row_bytes = mat.cols * mat.channels();
+            cv::parallel_for_(cv::Range(0, mat.rows),
+                              HorizontalBoxBody(mat, radii),
+                              (mat.rows + kTileRows - 1) / kTileRows);
+            cv::parallel_for_(cv::Range(0, (row_bytes + kStripBytes - 1) / kStripBytes),
+                              VerticalBoxBody(mat, radii));
+        }
+
+        // radii of three box blurs whose combination approximates a gaussian
+        std::vector<int> GaussianBoxRadii(double sigma)
+        {
+            // sigma == kMaxRadius already gives box widths of about 2 * kMaxRadius + 1,
+            // larger values would only overflow the width computation
+            sigma = std::min(sigma, static_cast<double>(kMaxRadius));
+
+            const int n = 3;
+            const double variance = sigma * sigma;
+            const double ideal_width = std::sqrt(12.0 * variance / n + 1.0);
+            int lower_width = static_cast<int>(std::floor(ideal_width));
+            if (0 == lower_width % 2) { --lower_width; }
+            const int upper_width = lower_width + 2;
+
+            // number of passes using the lower width
+            const double wl = lower_width;
+            const double ideal_count =
+                    (12.0 * variance - n * wl * wl - 4.0 * n * wl - 3.0 * n) /
+                    (-4.0 * wl - 4.0);
+            const int lower_count = cvRound(ideal_count);
+
+            std::vector<int> radii;
+            for (int i = 0; i < n; ++i)
+            {
+                const int width = (i < lower_count) ? lower_width : upper_width;
+                radii.push_back(ClampRadius((width - 1) / 2));
+            }
+            return radii;
+        }
+
+        // sharpen against a blurred copy. if alpha_index >= 0 the pixels are
+        // premultiplied, so colors are clamped to the sharpened alpha
+        class UnsharpBody : public cv::ParallelLoopBody
+        {
+        public:
+            UnsharpBody(cv::Mat& mat, const cv::Mat& blurred,
+                        float amount, int threshold, int alpha_index)
+                : mat_(mat), blurred_(blurred), amount_(amount),
+                  threshold_(threshold), alpha_index_(alpha_index) {}
+
+            void operator()(const cv::Range& range) const override
+            {
+                const int cn = mat_.channels();
+                const int row_bytes = mat_.cols * cn;
+                for (int y = range.start; y < range.end; ++y)
+                {
+                    uchar* row = mat_.ptr<uchar>(y);
+                    const uchar* blurred_row = blurred_.ptr<uchar>(y);
+                    for (int j = 0; j < row_bytes; ++j)
+                    {
+                        const int diff = row[j] - blurred_row[j];
+                        if (std::abs(diff) >= threshold_)
+                        {
+                            row[j] = cv::saturate_cast<uchar>(row[j] + amount_ * diff);
+                        }
+                    }
+
+                    if (alpha_index_ < 0) { continue; }
+                    for (uchar* pixel = row; pixel < row + row_bytes; pixel += cn)
+                    {
+                        const uchar alpha = pixel[alpha_index_];
+                        for (int c = 0; c < cn; ++c)
+                        {
+                            pixel[c] = std::min(pixel[c], alpha);
+                        }
+                    }
+                }
+            }
+
+        private:
+            cv::Mat& mat_;
+            const cv::Mat& blurred_;
+            float amount_;
+            int threshold_;
+            int alpha_index_;
+        };
+
+        // convert 4 channel pixels between straight and premultiplied alpha
+        class PremultiplyBody : public cv::ParallelLoopBody
+        {
+        public:
+            PremultiplyBody(cv::Mat& mat, int alpha_index, bool premultiply)
+                : mat_(mat), alpha_index_(alpha_index), premultiply_(premultiply) {}
+
+            void operator()(const cv::Range& range) const override
+            {
+                for (int y = range.start; y < range.end; ++y)
+                {
+                    uchar* row = mat_.ptr<uchar>(y);
+                    for (uchar* pixel = row; pixel < row + mat_.cols * 4; pixel += 4)
+                    {
+                        const int alpha = pixel[alpha_index_];
+                        for (int c = 0; c < 4; ++c)
+                        {
+                            if (c == alpha_index_) { continue; }
+                            if (premultiply_)
+                            {
+                                pixel[c] = static_cast<uchar>((pixel[c] * alpha + 127) / 255);
+                            }
+                            else
+                            {
+                                pixel[c] = (0 == alpha) ? 0 : static_cast<uchar>(
+                                    std::min(255, (pixel[c] * 255 + alpha / 2) / alpha));
+                            }
+                        }
+                    }
+                }
+            }
+
+        private:
+            cv::Mat& mat_;
+            int alpha_index_;
+            bool premultiply_;
+        };
+
+        void Premultiply(cv::Mat& mat, int alpha_index, bool premultiply)
+        {
+            cv::parallel_for_(cv::Range(0, mat.rows),
+                              PremultiplyBody(mat, alpha_index, premultiply),
+                              (mat.rows + kTileRows - 1) / kTileRows);
+        }
+
+        bool Unsharp(cv::Mat& mat, double sigma, double amount, int threshold, int alpha_index)
+        {
+            if (!IsSupported(mat)) { return false; }
+            if (!std::isfinite(sigma) || !std::isfinite(amount)) { return false; }
+            if (sigma <= 0) { return true; }
+
+            cv::Mat blurred = mat.clone();
+            GaussianBlur(blurred, sigma);
+            cv::parallel_for_(cv::Range(0, mat.rows),
+                              UnsharpBody(mat, blurred, static_cast<float>(amount), threshold, alpha_index),
+                              (mat.rows + kTileRows - 1) / kTileRows);
+            return true;
+        }
+
+        // histograms of every channel of a run of image columns, the 256 fine
+        // bins of a column are grouped by 16 into its coarse bins (Perreault &
+        // Hebert). fine bins are stored bucket by bucket, so bringing one
+        // bucket of a kernel histogram along a row walks consecutive columns
+        class ColumnHistograms
+        {
+        public:
+            // bytes of histograms per column and channel
+            static const int kColumnBytes = (16 + 256) * sizeof(ushort);
+
+            void Reset(int width, int cn)
+            {
+                width_ = width;
+                coarse_.assign(cn * width * 16, 0);
+                fine_.assign(cn * 16 * width * 16, 0);
+            }
+
+            // 16 coarse bins of column j of channel c
+            const ushort* Coarse(int c, int j) const { return &coarse_[(c * width_ + j) * 16]; }
+
+            // 16 fine bins of bucket k of column j of channel c
+            const ushort* Fine(int c, int k, int j) const { return &fine_[((c * 16 + k) * width_ + j) * 16]; }
+
+            // add weight times the pixels of row to every column, or remove
+            // them again with a negative weight
+            void Add(const uchar* row, int cn, int weight)
+            {
+                for (int c = 0; c < cn; ++c)
+                {
+                    ushort* coarse = &coarse_[c * width_ * 16];
+                    ushort* fine = &fine_[c * 16 * width_ * 16];
+                    for (int j = 0; j < width_; ++j)
+                    {
+                        const uchar value = row[j * cn + c];
+                        coarse[j * 16 + (value >> 4)] += weight;
+                        fine[((value >> 4) * width_ + j) * 16 + (value & 15)] += weight;
+                    }
+                }
+            }
+
+        private:
+            int width_ = 0;
+            std::vector<ushort> coarse_;
+            std::vector<ushort> fine_;
+        };
+
+        // sliding median over tiles of rows and columns. every tile keeps the
+        // column histograms of its strip, widened by the radius on both sides
+        // and slid down a row at a time, and a kernel histogram slid along each
+        // row whose fine bins are only brought up to date for the coarse bin
+        // that holds the median. reads src and writes dst
+        class MedianBody : public cv::ParallelLoopBody
+        {
+        public:
+            MedianBody(const cv::Mat& src, cv::Mat& dst, int radius, int bands, int strip_cols)
+                : src_(src), dst_(dst), radius_(radius), bands_(bands), strip_cols_(strip_cols),
+                  strips_((src.cols + strip_cols - 1) / strip_cols) {}
+
+            int tiles() const { return bands_ * strips_; }
+
+            void operator()(const cv::Range& range) const override
+            {
+                static_assert(2 * kMaxRadius + 1 <= std::numeric_limits<ushort>::max(),
+                              "column histogram bins must hold 2 * radius + 1 samples");
+                ColumnHistograms columns;
+                for (int tile = range.start; tile < range.end; ++tile)
+                {
+                    const int band = tile / strips_;
+                    const int strip = tile % strips_;
+                    FilterTile(columns,
+                               band * src_.rows / bands_, (band + 1) * src_.rows / bands_,
+                               strip * strip_cols_, std::min((strip + 1) * strip_cols_, src_.cols));
+                }
+            }
+
+        private:
+            // the histograms hold the image columns [first, first + width)
+            void FilterTile(ColumnHistograms& columns, int y0, int y1, int x0, int x1) const
+            {
+                const int cn = src_.channels();
+                const int r = radius_;
+                const int last_row = src_.rows - 1;
+                const int first = std::max(x0 - r, 0);
+                const int width = std::min(x1 - 1 + r, src_.cols - 1) - first + 1;
+                columns.Reset(width, cn);
+
+                // column histograms of the window centered on row y0
+                for (int k = std::max(y0 - r, 0); k <= std::min(y0 + r, last_row); ++k)
+                {
+                    columns.Add(src_.ptr<uchar>(k) + first * cn, cn,
+                                ReplicatedWeight(k, y0 - r, y0 + r, last_row));
+                }
+
+                for (int y = y0; y < y1; ++y)
+                {
+                    // slide the column histograms down one row
+                    if (y > y0)
+                    {
+                        columns.Add(src_.ptr<uchar>(std::min(y + r, last_row)) + first * cn, cn, 1);
+                        columns.Add(src_.ptr<uchar>(std::max(y - r - 1, 0)) + first * cn, cn, -1);
+                    }
+
+                    for (int c = 0; c < cn; ++c)
+                    {
+                        FilterRow(columns, first, y, x0, x1, c);
+                    }
+                }
+            }
+
+            // median of channel c for the pixels [x0, x1) of row y
+            void FilterRow(const ColumnHistograms& columns, int first, int y, int x0, int x1, int c) const
+            {
+                const int cn = src_.channels();
+                const int r = radius_;
+                const int window = 2 * r + 1;
+                const int last_col = src_.cols - 1;
+                const uint rank = static_cast<uint>(window) * window / 2;
+                auto column = [&](int j) {
+                    return std::min(std::max(j, 0), last_col) - first;
+                };
+
+                // fine bucket k holds the columns [updated[k] - window, updated[k]),
+                // all of them start out of date
+                uint coarse[16] = { 0 };
+                uint fine[256];
+                int updated[16];
+                std::fill(updated, updated + 16, x0 - r);
+
+                for (int j = std::max(x0 - r, 0); j <= std::min(x0 + r, last_col); ++j)
+                {
+                    const uint weight = ReplicatedWeight(j, x0 - r, x0 + r, last_col);
+                    const ushort* add = columns.Coarse(c, column(j));
+                    for (int k = 0; k < 16; ++k)
+                    {
+                        coarse[k] += weight * add[k];
+                    }
+                }
+
+                uchar* dst_row = dst_.ptr<uchar>(y);
+                for (int x = x0; x < x1; ++x)
+                {
+                    // coarse bucket holding the median
+                    uint count = 0;
+                    int k = 0;
+                    for (; k < 15; ++k)
+                    {
+                        if (count + coarse[k] > rank) { break; }
+                        count += coarse[k];
+                    }
+
+                    // bring its fine bins to the window [x - r, x + r]
+                    uint* bins = &fine[k * 16];
+                    if (updated[k] <= x - r)
+                    {
+                        std::fill(bins, bins + 16, 0);
+                        for (int j = std::max(x - r, 0); j <= std::min(x + r, last_col); ++j)
+                        {
+                            const uint weight = ReplicatedWeight(j, x - r, x + r, last_col);
+                            const ushort* add = columns.Fine(c, k, column(j));
+                            for (int v = 0; v < 16; ++v)
+                            {
+                                bins[v] += weight * add[v];
+                            }
+                        }
+                    }
+                    else
+                    {
+                        for (; updated[k] <= x + r; ++updated[k])
+                        {
+                            const ushort* add = columns.Fine(c, k, column(updated[k]));
+                            const ushort* sub = columns.Fine(c, k, column(updated[k] - window));
+                            for (int v = 0; v < 16; ++v)
+                            {
+                                bins[v] += add[v];
+                                bins[v] -= sub[v];
+                            }
+                        }
+                    }
+                    updated[k] = x + r + 1;
+
+                    int v = 0;
+                    for (; v < 15; ++v)
+                    {
+                        count += bins[v];
+                        if (count > rank) { break; }
+                    }
+                    dst_row[x * cn + c] = static_cast<uchar>(k * 16 + v);
+
+                    // slide the coarse kernel histogram right one column
+                    if (x + 1 < x1)
+                    {
+                        const ushort* add = columns.Coarse(c, column(x + r + 1));
+                        const ushort* sub = columns.Coarse(c, column(x - r));
+                        for (int i = 0; i < 16; ++i)
+                        {
+                            coarse[i] += add[i];
+                            coarse[i] -= sub[i];
+                        }
+                    }
+                }
+            }
+
+            const cv::Mat& src_;
+            cv::Mat& dst_;
+            int radius_;
+            int bands_;
+            int strip_cols_;
+            int strips_;
+        };
+
+        // position of alpha in the pixels of qimage, -1 if it has none
+        int AlphaIndex(const QImage& qimage)
+        {
+            switch (qimage.format())
+            {
+            case QImage::Format_ARGB32:
+            case QImage::Format_ARGB32_Premultiplied:
+            #if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+                return 3;
+            #else
+                return 0;
+            #endif
+            case QImage::Format_RGBA8888:
+            case QImage::Format_RGBA8888_Premultiplied:
+                return 3;
+            default:
+                return -1;
+            }
+        }
+
+        // wrap qimage's pixels in a cv::Mat and run filter on it,
+        // filter gets the mat and the position of its alpha channel.
+        // if changes_pixels is false the call is a no-op and qimage is left alone
+        template <typename Filter>
+        bool FilterQImage(QImage& qimage, bool changes_pixels, Filter filter)
+        {
+            // indices of a color table can't be filtered
+            if (qimage.isNull() || QImage::Format_Indexed8 == qimage.format()) { return false; }
+
+            // probe the format through the const bits, a rejected or
+            // unchanged image must not pay for a detach
+            const QImage& shared = qimage;
+            if (!IsSupported(convert::QImageToMat_Shared(shared, nullptr))) { return false; }
+            if (!changes_pixels) { return true; }
+
+            // detach first, otherwise the shared mat would also
+            // write into every implicitly shared copy of qimage
+            qimage.bits();
+            cv::Mat mat = convert::QImageToMat_Shared(qimage, nullptr);
+
+            // filter straight alpha premultiplied, otherwise the color
+            // of transparent pixels leaks into the visible ones
+            const int alpha_index = AlphaIndex(qimage);
+            const bool straight_alpha = QImage::Format_ARGB32 == qimage.format() ||
+                                        QImage::Format_RGBA8888 == qimage.format();
+            if (straight_alpha) { Premultiply(mat, alpha_index, true); }
+            const bool filtered = filter(mat, alpha_index);
+            if (straight_alpha) { Premultiply(mat, alpha_index, false); }
+            return filtered;
+        }
+
+    } // end of anonymous namespace
+
+    bool BoxBlur(cv::Mat& mat, int radius)
+    {
+        if (!IsSupported(mat)) { return false; }
+
+        BoxPasses(mat, std::vector<int>(1, ClampRadius(radius)));
+        return true;
+    }
+
+    bool GaussianBlur(cv::Mat& mat, double sigma)
+    {
+        if (!IsSupported(mat)) { return false; }
+        if (!std::isfinite(sigma)) { return false; }
+        if (sigma <= 0) { return true; }
+
+        if (sigma < kMinBoxSigma)
+        {
+            cv::GaussianBlur(mat, mat, cv::Size(), sigma, sigma,
+                             cv::BORDER_REPLICATE | cv::BORDER_ISOLATED);
+            return true;
+        }
+
+        BoxPasses(mat, GaussianBoxRadii(sigma));
+        return true;
+    }
+
+    bool UnsharpMask(cv::Mat& mat, double sigma, double amount, int threshold)
+    {
+        return Unsharp(mat, sigma, amount, threshold, -1);
+    }
+
+    bool MedianBlur(cv::Mat& mat, int radius)
+    {
+        if (!IsSupported(mat)) { return false; }
+        radius = ClampRadius(radius);
+        if (0 == radius) { return true; }
+
+        // tiles read pixels across their borders, so they read from an unfiltered copy
+        const cv::Mat src = mat.clone();
+
+        // strips whose column histograms fit in the cache, but wide enough
+        // that the overlap of their windows stays small
+        const int budget = kMedianCacheBytes / (mat.channels() * ColumnHistograms::kColumnBytes);
+        const int strip_cols = std::min(std::max(budget - 2 * radius, kMedianMinStripRadii * radius), mat.cols);
+        const int strips = (mat.cols + strip_cols - 1) / strip_cols;
+
+        // every band rebuilds its column histograms, so rows are only
+        // split until there are a few tiles per thread to balance them
+        const int tiles = kMedianTilesPerThread * cv::getNumThreads();
+        const int bands = std::max(1, std::min((tiles + strips - 1) / strips,
+                                               mat.rows / kMedianMinBandRows));
+        const MedianBody body(src, mat, radius, bands, strip_cols);
+        cv::parallel_for_(cv::Range(0, body.tiles()), body);
+        return true;
+    }
+
+    bool BoxBlur(QImage& qimage, int radius)
+    {
+        return FilterQImage(qimage, ClampRadius(radius) > 0, [radius](cv::Mat& mat, int) {
+            return BoxBlur(mat, radius);
+        });
+    }
+
+    bool GaussianBlur(QImage& qimage, double sigma)
+    {
+        if (!std::isfinite(sigma)) { return false; }
+
+        return FilterQImage(qimage, sigma > 0, [sigma](cv::Mat& mat, int) {
+            return GaussianBlur(mat, sigma);
+        });
+    }
+
+    bool UnsharpMask(QImage& qimage, double sigma, double amount, int threshold)
+    {
+        if (!std::isfinite(sigma) || !std::isfinite(amount)) { return false; }
+
+        return FilterQImage(qimage, sigma > 0, [=](cv::Mat& mat, int alpha_index) {
+            return Unsharp(mat, sigma, amount, threshold, alpha_index);
+        });
+    }
+
+    bool MedianBlur(QImage& qimage, int radius)
+    {
+        return FilterQImage(qimage, ClampRadius(radius) > 0, [radius](cv::Mat& mat, int) {
+            return MedianBlur(mat, radius);
+        });
+    }
+
+} // end of namespace 'jz::filter'
+
+} // end of namespace jz
@@ -0,0 +1,54 @@
+#ifndef IMAGE_FILTER_FILTER_H
+#define IMAGE_FILTER_FILTER_H
+
+#include <QImage>
+#include <opencv/cv.h>
+
+namespace jz
+{
+    namespace filter
+    {
+        // all filters work in place on 8-bit images with 1, 3 or 4 channels,
+        // borders are replicated and the cv::Mat overloads filter every channel
+        // (alpha included) independently.
+        // each one costs constant time per pixel regardless of the radius and
+        // runs tile by tile in parallel through cv::parallel_for_.
+        // they return false if the image is empty or its type is not supported,
+        // or if a floating point parameter is not finite.
+
+        // largest radius accepted, bigger values are clamped.
+        // the median keeps 2 * radius + 1 samples per column in ushort bins
+        const int kMaxRadius = 16383;
+
+        // mean of the (2 * radius + 1)^2 neighbourhood
+        bool BoxBlur(cv::Mat& mat, int radius);
+
+        // gaussian blur approximated by three successive box blurs, which stay
+        // within 8 levels of the exact kernel even on hard edges,
+        // sigmas below 2.5 use the exact kernel which is small enough
+        bool GaussianBlur(cv::Mat& mat, double sigma);
+
+        // sharpen by adding back amount * (image - gaussian blurred image),
+        // pixels differing from the blurred image by less than threshold are kept
+        bool UnsharpMask(cv::Mat& mat, double sigma, double amount, int threshold = 0);
+
+        // median of the (2 * radius + 1)^2 neighbourhood using sliding histograms
+        bool MedianBlur(cv::Mat& mat, int radius);
+
+        // filter a QImage in place, the pixels are wrapped with
+        // convert::QImageToMat_Shared() so no conversion copy is made.
+        // straight alpha (Format_ARGB32, Format_RGBA8888) is premultiplied in
+        // place while filtering and converted back, so transparent pixels don't
+        // bleed their color, fully transparent pixels come back black.
+        // a radius or sigma that filters nothing leaves the pixels untouched.
+        // premultiplied formats are filtered as is, UnsharpMask clamps the
+        // sharpened colors to the sharpened alpha to keep them valid.
+        // Format_Indexed8 and formats that can't be shared are rejected.
+        bool BoxBlur(QImage& qimage, int radius);
+        bool GaussianBlur(QImage& qimage, double sigma);
+        bool UnsharpMask(QImage& qimage, double sigma, double amount, int threshold = 0);
+        bool MedianBlur(QImage& qimage, int radius);
+    }
+}
+
+#endif
@@ -0,0 +1,358 @@
+// standalone check of base/filter against the OpenCV reference filters.
+// build filter_check.pro and run it, every failed check is printed and
+// the number of failures is returned
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include <QImage>
+#include "opencv2/opencv.hpp"
+
+#include "base/filter.h"
+
+namespace
+{
+    enum FilterKind
+    {
+        FK_BOX,
+        FK_MEDIAN,
+        FK_GAUSSIAN
+    };
+
+    const char* kFilterNames[] = { "BoxBlur", "MedianBlur", "GaussianBlur" };
+
+    // radii 50 and sigma 40 are larger than every test image
+    const int kRadii[] = { 1, 2, 5, 50 };
+    const double kSigmas[] = { 0.8, 2.0, 2.75, 3.5, 12.0, 40.0 };
+
+    // GaussianBlur calls cv::GaussianBlur below this sigma
+    const double kMinBoxSigma = 2.5;
+
+    int failures = 0;
+
+    void Check(bool ok, const char* what, const cv::Mat& mat, double param)
+    {
+        if (ok) { return; }
+
+        ++failures;
+        std::printf("FAILED %s: %dx%d, %d channels, param %g\n",
+                    what, mat.rows, mat.cols, mat.channels(), param);
+    }
+
+    void Check(bool ok, const char* what)
+    {
+        if (ok) { return; }
+
+        ++failures;
+        std::printf("FAILED %s\n", what);
+    }
+
+    cv::Mat RandomMat(int rows, int cols, int type)
+    {
+        cv::Mat mat(rows, cols, type);
+        cv::randu(mat, cv::Scalar::all(0), cv::Scalar::all(256));
+        return mat;
+    }
+
+    // a diagonal step from 255 to 0, the hardest case for the box gaussian
+    cv::Mat StepMat(int rows, int cols, int type)
+    {
+        cv::Mat mat(rows, cols, type);
+        const int cn = mat.channels();
+        for (int y = 0; y < rows; ++y)
+        {
+            uchar* row = mat.ptr<uchar>(y);
+            for (int x = 0; x < cols * cn; ++x)
+            {
+                row[x] = x / cn + y < (rows + cols) / 2 ? 255 : 0;
+            }
+        }
+        return mat;
+    }
+
+    // largest difference allowed against the OpenCV filter, the box blur
+    // rounds between its two passes and the gaussian made of three boxes
+    // was measured at most 7 levels off on noise and 6 on step edges
+    int Tolerance(FilterKind kind, double param)
+    {
+        switch (kind)
+        {
+        case FK_BOX:
+            return 1;
+        case FK_MEDIAN:
+            return 0;
+        default:
+            return param < kMinBoxSigma ? 0 : 7;
+        }
+    }
+
+    bool Apply(FilterKind kind, cv::Mat& mat, double param)
+    {
+        switch (kind)
+        {
+        case FK_BOX:
+            return jz::filter::BoxBlur(mat, static_cast<int>(param));
+        case FK_MEDIAN:
+            return jz::filter::MedianBlur(mat, static_cast<int>(param));
+        default:
+            return jz::filter::GaussianBlur(mat, param);
+        }
+    }
+
+    cv::Mat Reference(FilterKind kind, const cv::Mat& src, double param)
+    {
+        cv::Mat dst;
+        const int size = 2 * static_cast<int>(param) + 1;
+        switch (kind)
+        {
+        case FK_BOX:
+            cv::blur(src, dst, cv::Size(size, size), cv::Point(-1, -1), cv::BORDER_REPLICATE);
+            break;
+        case FK_MEDIAN:
+            cv::medianBlur(src, dst, size);
+            break;
+        default:
+            cv::GaussianBlur(src, dst, cv::Size(), param, param, cv::BORDER_REPLICATE);
+            break;
+        }
+        return dst;
+    }
+
+    void CheckFilter(FilterKind kind, const cv::Mat& src, double param)
+    {
+        cv::Mat filtered = src.clone();
+        Check(Apply(kind, filtered, param), kFilterNames[kind], src, param);
+        const double diff = cv::norm(filtered, Reference(kind, src, param), cv::NORM_INF);
+        Check(diff <= Tolerance(kind, param), kFilterNames[kind], src, param);
+    }
+
+    // compare against src + amount * (src - blurred) computed from the OpenCV
+    // gaussian. the box gaussian may differ by the gaussian tolerance, so
+    // pixels whose difference is that close to threshold can go either way
+    void CheckUnsharp(const cv::Mat& src, double sigma, double amount, int threshold)
+    {
+        cv::Mat sharpened = src.clone();
+        Check(jz::filter::UnsharpMask(sharpened, sigma, amount, threshold), "UnsharpMask", src, sigma);
+
+        cv::Mat blurred;
+        cv::GaussianBlur(src, blurred, cv::Size(), sigma, sigma, cv::BORDER_REPLICATE);
+        const int slack = Tolerance(FK_GAUSSIAN, sigma);
+        const double tolerance = std::ceil(amount * slack) + (slack > 0 ? 1 : 0);
+
+        bool kept = true;
+        bool sharpened_ok = true;
+        for (int y = 0; y < src.rows; ++y)
+        {
+            const uchar* src_row = src.ptr<uchar>(y);
+            const uchar* blurred_row = blurred.ptr<uchar>(y);
+            const uchar* row = sharpened.ptr<uchar>(y);
+            for (int j = 0; j < src.cols * src.channels(); ++j)
+            {
+                const int diff = src_row[j] - blurred_row[j];
+                if (std::abs(diff) < threshold - slack)
+                {
+                    kept = kept && row[j] == src_row[j];
+                }
+                else if (std::abs(diff) >= threshold + slack)
+                {
+                    const uchar expected = cv::saturate_cast<uchar>(src_row[j] + amount * diff);
+                    sharpened_ok = sharpened_ok && std::abs(row[j] - expected) <= tolerance;
+                }
+            }
+        }
+        Check(kept, "UnsharpMask changed a pixel below threshold", src, sigma);
+        Check(sharpened_ok, "UnsharpMask", src, sigma);
+    }
+
+    // a non-continuous ROI is filtered on its own and nothing around it changes
+    void CheckRoi(FilterKind kind, int type, double param)
+    {
+        const cv::Rect rect(5, 7, 31, 22);
+        cv::Mat image = RandomMat(48, 64, type);
+        const cv::Mat original = image.clone();
+        cv::Mat roi = image(rect);
+        Check(!roi.isContinuous(), "ROI is continuous", roi, param);
+
+        const cv::Mat expected = Reference(kind, roi.clone(), param);
+        Check(Apply(kind, roi, param), kFilterNames[kind], roi, param);
+        Check(cv::norm(roi, expected, cv::NORM_INF) <= Tolerance(kind, param),
+              kFilterNames[kind], roi, param);
+
+        cv::Mat outside = image.clone();
+        cv::Mat original_outside = original.clone();
+        outside(rect).setTo(cv::Scalar::all(0));
+        original_outside(rect).setTo(cv::Scalar::all(0));
+        Check(0 == cv::norm(outside, original_outside, cv::NORM_INF),
+              "pixels around the ROI changed", roi, param);
+    }
+
+    void CheckMats()
+    {
+        const int sizes[][2] = { { 1, 1 }, { 1, 37 }, { 41, 1 }, { 2, 2 }, { 17, 23 }, { 64, 96 } };
+        const int types[] = { CV_8UC1, CV_8UC3, CV_8UC4 };
+
+        for (const auto& size : sizes)
+        {
+            for (int type : types)
+            {
+                const cv::Mat sources[] = { RandomMat(size[0], size[1], type),
+                                            StepMat(size[0], size[1], type) };
+                for (const cv::Mat& src : sources)
+                {
+                    for (int radius : kRadii)
+                    {
+                        CheckFilter(FK_BOX, src, radius);
+                        CheckFilter(FK_MEDIAN, src, radius);
+                    }
+                    for (double sigma : kSigmas)
+                    {
+                        CheckFilter(FK_GAUSSIAN, src, sigma);
+                    }
+                    for (double sigma : { 1.5, 4.0 })
+                    {
+                        CheckUnsharp(src, sigma, 0.5, 0);
+                        CheckUnsharp(src, sigma, 2.0, 0);
+                        CheckUnsharp(src, sigma, 2.0, 12);
+                    }
+                }
+            }
+        }
+
+        for (int type : types)
+        {
+            for (int radius : kRadii)
+            {
+                CheckRoi(FK_BOX, type, radius);
+                CheckRoi(FK_MEDIAN, type, radius);
+            }
+            for (double sigma : kSigmas)
+            {
+                CheckRoi(FK_GAUSSIAN, type, sigma);
+            }
+        }
+    }
+
+    void CheckInvalidInput()
+    {
+        cv::Mat empty;
+        Check(!jz::filter::BoxBlur(empty, 1), "empty mat accepted");
+
+        cv::Mat wide = RandomMat(8, 8, CV_16UC1);
+        Check(!jz::filter::MedianBlur(wide, 1), "16-bit mat accepted");
+
+        cv::Mat mat = RandomMat(8, 8, CV_8UC1);
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        Check(!jz::filter::GaussianBlur(mat, nan), "NaN sigma accepted");
+        Check(!jz::filter::UnsharpMask(mat, 2.0, nan), "NaN amount accepted");
+        Check(jz::filter::GaussianBlur(mat, 1e300), "huge sigma rejected");
+
+        QImage indexed(8, 8, QImage::Format_Indexed8);
+        Check(!jz::filter::BoxBlur(indexed, 1), "Format_Indexed8 accepted");
+
+        // rejected formats are turned down before the pixels are detached
+        QImage rgb16(8, 8, QImage::Format_RGB16);
+        const QImage shared = rgb16;
+        Check(!jz::filter::BoxBlur(rgb16, 1), "Format_RGB16 accepted");
+        Check(!jz::filter::MedianBlur(rgb16, 0), "no-op on Format_RGB16 accepted");
+        Check(shared.constBits() == rgb16.constBits(), "rejected image was detached");
+    }
+
+    // transparent red next to opaque black must not tint the visible pixels
+    void CheckStraightAlpha(QImage::Format format)
+    {
+        QImage qimage(40, 10, format);
+        for (int y = 0; y < qimage.height(); ++y)
+        {
+            for (int x = 0; x < qimage.width(); ++x)
+            {
+                qimage.setPixel(x, y, x < 20 ? qRgba(0, 0, 0, 255) : qRgba(255, 0, 0, 0));
+            }
+        }
+        const QImage copy = qimage;
+
+        Check(jz::filter::GaussianBlur(qimage, 4.0), "straight alpha GaussianBlur");
+        bool halo = false;
+        for (int y = 0; y < qimage.height(); ++y)
+        {
+            for (int x = 0; x < qimage.width(); ++x)
+            {
+                const QRgb pixel = qimage.pixel(x, y);
+                // unpremultiplying rounds by up to 255 / (2 * alpha)
+                halo = halo || (qAlpha(pixel) >= 32 && qRed(pixel) > 4);
+            }
+        }
+        Check(!halo, "transparent color bleeds into visible pixels");
+        Check(qRgba(255, 0, 0, 0) == copy.pixel(30, 5), "implicitly shared copy changed");
+    }
+
+    bool SameBytes(const QImage& a, const QImage& b)
+    {
+        if (a.size() != b.size() || a.format() != b.format()) { return false; }
+        for (int y = 0; y < a.height(); ++y)
+        {
+            if (!std::equal(a.constScanLine(y),
+                            a.constScanLine(y) + a.width() * a.depth() / 8,
+                            b.constScanLine(y)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // filters that change nothing must not round trip straight alpha
+    // through premultiplied, that would drop the color of transparent pixels
+    void CheckStraightAlphaNoOp(QImage::Format format)
+    {
+        QImage qimage(4, 4, format);
+        qimage.fill(qRgba(255, 0, 0, 0));
+        qimage.setPixel(1, 2, qRgba(200, 100, 50, 3));
+        qimage.setPixel(2, 1, qRgba(10, 20, 30, 255));
+        const QImage original = qimage.copy();
+
+        Check(jz::filter::BoxBlur(qimage, 0), "BoxBlur radius 0");
+        Check(jz::filter::MedianBlur(qimage, 0), "MedianBlur radius 0");
+        Check(jz::filter::GaussianBlur(qimage, 0.0), "GaussianBlur sigma 0");
+        Check(jz::filter::UnsharpMask(qimage, 0.0, 1.0), "UnsharpMask sigma 0");
+        Check(SameBytes(qimage, original), "no-op filter changed straight alpha pixels");
+    }
+
+    // sharpening premultiplied pixels must keep every color below alpha
+    void CheckPremultipliedAlpha()
+    {
+        QImage qimage(9, 9, QImage::Format_ARGB32_Premultiplied);
+        qimage.fill(qRgba(0, 0, 0, 255));
+        qimage.setPixel(4, 4, qRgba(200, 200, 200, 200));
+
+        Check(jz::filter::UnsharpMask(qimage, 1.0, 1.0), "premultiplied UnsharpMask");
+        bool invalid = false;
+        for (int y = 0; y < qimage.height(); ++y)
+        {
+            for (int x = 0; x < qimage.width(); ++x)
+            {
+                const QRgb pixel = qimage.pixel(x, y);
+                invalid = invalid ||
+                          qRed(pixel) > qAlpha(pixel) ||
+                          qGreen(pixel) > qAlpha(pixel) ||
+                          qBlue(pixel) > qAlpha(pixel);
+            }
+        }
+        Check(!invalid, "sharpened color exceeds premultiplied alpha");
+    }
+
+} // end of anonymous namespace
+
+int main()
+{
+    CheckMats();
+    CheckInvalidInput();
+    CheckStraightAlpha(QImage::Format_ARGB32);
+    CheckStraightAlpha(QImage::Format_RGBA8888);
+    CheckStraightAlphaNoOp(QImage::Format_ARGB32);
+    CheckStraightAlphaNoOp(QImage::Format_RGBA8888);
+    CheckPremultipliedAlpha();
+
+    std::printf("%d failed checks\n", failures);
+    return failures;
+}
@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# standalone check of base/filter against OpenCV
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = filter_check
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += filter_check.cpp \
+    ../base/convert.cpp \
+    ../base/filter.cpp
+
+HEADERS  += ../base/convert.h \
+    ../base/filter.h
+
+INCLUDEPATH += .. \
+    ..\..\ThirdParty\opencv\include
+
+# copy libs to the directory generated by compiler if using relative path
+LIBS += .\lib\opencv\libopencv_core310.dll.a\
+        .\lib\opencv\libopencv_imgproc310.dll.a